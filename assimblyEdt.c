@@ -2,8 +2,8 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
-
-#define MAX_LINE_LENGTH 100
+#include <stdbool.h>
+#include "assimblyEdt.h"
 
 // Function to convert an integer (0-15) to a binary string of fixed length
 void int_to_binary(int value, char *output, int bits) {
@@ -101,6 +101,59 @@ void trim(char *str) {
     str[len] = '\0';
 }
 
+// Function to encode one line read from the source. Returns 1 when it
+// produced machine code, 0 for a blank line and -1 for an invalid one.
+int assemble_line(char *line, char *machine_code, int line_number) {
+    // Remove newline character and surrounding whitespace
+    line[strcspn(line, "\n")] = '\0';
+    trim(line);
+
+    if (strlen(line) == 0) {
+        return 0;
+    }
+
+    if (convert_to_machine_code(line, machine_code) == -1) {
+        fprintf(stderr, "Warning: Invalid instruction '%s' on line %d\n", line, line_number);
+        return -1;
+    }
+    return 1;
+}
+
+// Function to assemble a source file straight into an instruction memory
+int assemble_to_memory(const char *filename, unsigned char memory[], int size) {
+    FILE *input_file = fopen(filename, "r");
+    if (!input_file) {
+        fprintf(stderr, "Error: Failed to open input file %s\n", filename);
+        return -1;
+    }
+
+    memset(memory, 0, size);
+
+    char line[MAX_LINE_LENGTH];
+    char machine_code[9];
+    int count = 0;
+
+    int line_number = 1;
+    while (fgets(line, sizeof(line), input_file)) {
+        // A line longer than the buffer arrives in pieces, count it once
+        bool line_end = strchr(line, '\n') != NULL;
+
+        if (assemble_line(line, machine_code, line_number) == 1) {
+            if (count == size) {
+                fprintf(stderr, "Warning: Program exceeds %d instructions, line %d ignored\n", size, line_number);
+            } else {
+                memory[count++] = (unsigned char)strtol(machine_code, NULL, 2);
+            }
+        }
+
+        if (line_end) line_number++;
+    }
+
+    fclose(input_file);
+    return count;
+}
+
+#ifndef K2_NO_MAIN
 int main(int argc, char *argv[]) {
     if (argc < 2) {
         handle_error("Please provide the assembly file name as a command line argument.");
@@ -133,30 +186,20 @@ int main(int argc, char *argv[]) {
 
     char line[MAX_LINE_LENGTH];
     char machine_code[9];
-    int line_number = 1;
 
     // Read and process each line
+    int line_number = 1;
     while (fgets(line, sizeof(line), input_file)) {
-        // Remove newline character
-        line[strcspn(line, "\n")] = '\0';
-        
-        // Trim whitespace
-        trim(line);
-
-        // Skip empty lines
-        if (strlen(line) == 0) {
-            continue;
-        }
+        // A line longer than the buffer arrives in pieces, count it once
+        bool line_end = strchr(line, '\n') != NULL;
 
         // Convert and print the instruction and its machine code
-        if (convert_to_machine_code(line, machine_code) == -1) {
-            fprintf(stderr, "Warning: Invalid instruction '%s' on line %d\n", line, line_number);
-        } else {
+        if (assemble_line(line, machine_code, line_number) == 1) {
             printf("Line %d: %s -> Machine Code: %s\n", line_number, line, machine_code);
             fprintf(output_file, "%s\n", machine_code);
         }
 
-        line_number++;
+        if (line_end) line_number++;
     }
 
     fclose(input_file);
@@ -165,3 +208,4 @@ int main(int argc, char *argv[]) {
     printf("Successfully generated output file: %s\n", output_filename);
     return 0;
 }
+#endif
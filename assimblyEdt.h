@@ -0,0 +1,14 @@
+#ifndef ASSIMBLYEDT_H
+#define ASSIMBLYEDT_H
+
+#define MAX_LINE_LENGTH 100
+
+void int_to_binary(int value, char *output, int bits);
+int convert_to_machine_code(const char *instruction, char *machine_code);
+void trim(char *str);
+int assemble_line(char *line, char *machine_code, int line_number);
+
+// Assemble filename into memory, returns the instruction count or -1
+int assemble_to_memory(const char *filename, unsigned char memory[], int size);
+
+#endif
@@ -0,0 +1,178 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <libgen.h>
+#include <poll.h>
+#include <sys/wait.h>
+#include <sys/inotify.h>
+#include "assimblyEdt.h"
+#include "k2_MICRO.h"
+
+#define EVENT_BUF_SIZE 4096
+
+void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s run [--watch] [--vcd <trace.vcd>] <file.asm>\n", prog);
+}
+
+// Assemble the source into IM and execute it without writing a .bin file
+int assemble_and_run(const char *filename, const char *vcd_file) {
+    int count = assemble_to_memory(filename, IM, IM_SIZE);
+    if (count < 0) {
+        return 1;
+    }
+    printf("Assembled %d instructions from %s\n", count, filename);
+
+    Trace *trace = NULL;
+    if (vcd_file != NULL) {
+        trace = trace_open(vcd_file);
+        if (trace == NULL) return 1;
+    }
+
+    run_program(IM, 'R', trace);
+    if (trace_close(trace) != 0) {
+        fprintf(stderr, "Error: Failed to write trace file %s\n", vcd_file);
+        return 1;
+    }
+    return 0;
+}
+
+// Start one assemble-and-run in a child process so the watcher stays
+// responsive even when the program never halts
+pid_t start_run(const char *filename, const char *vcd_file, const sigset_t *run_mask) {
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == 0) {
+        sigprocmask(SIG_SETMASK, run_mask, NULL);
+        exit(assemble_and_run(filename, vcd_file));
+    }
+    if (pid < 0) {
+        perror("Error: fork");
+    }
+    return pid;
+}
+
+// SIGTERM makes the child leave run_program() and flush its trace
+void stop_run(pid_t pid) {
+    if (pid > 0) {
+        kill(pid, SIGTERM);
+        waitpid(pid, NULL, 0);
+    }
+}
+
+// Re-run every time the source is saved. The directory is watched rather
+// than the file so editors that save by renaming a temp file are seen too.
+// Manual check with a program that never halts: loop.asm adds RB to RA
+// forever and prints RO=0, 1, 2, ... Start `k2 run --watch loop.asm`,
+// change RB=9 (RB=1) to RB=10 (RB=2) and save; the count must restart
+// from RO=0 and step by 2.
+int watch(const char *filename, const char *vcd_file) {
+    char *dir_copy = strdup(filename);
+    char *name_copy = strdup(filename);
+    const char *dir = dirname(dir_copy);
+    const char *name = basename(name_copy);
+
+    int fd = inotify_init1(IN_CLOEXEC);
+    if (fd < 0 || inotify_add_watch(fd, dir, IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+        perror("Error: inotify");
+        free(dir_copy);
+        free(name_copy);
+        return 1;
+    }
+
+    // SIGINT and SIGTERM stay blocked except inside ppoll(), so a signal
+    // arriving between the stop_requested check and the wait is not lost
+    sigset_t stop_signals, run_mask;
+    sigemptyset(&stop_signals);
+    sigaddset(&stop_signals, SIGINT);
+    sigaddset(&stop_signals, SIGTERM);
+    sigprocmask(SIG_BLOCK, &stop_signals, &run_mask);
+
+    printf("Watching %s for changes (Ctrl+C to stop)...\n", filename);
+    pid_t child = start_run(filename, vcd_file, &run_mask);
+
+    char buf[EVENT_BUF_SIZE] __attribute__((aligned(__alignof__(struct inotify_event))));
+    struct pollfd pfd = {fd, POLLIN, 0};
+    int status = 0;
+    while (!stop_requested) {
+        if (ppoll(&pfd, 1, NULL, &run_mask) < 0) {
+            if (errno == EINTR) continue;
+            perror("Error: inotify poll");
+            status = 1;
+            break;
+        }
+
+        ssize_t len = read(fd, buf, sizeof(buf));
+        if (len < 0) {
+            perror("Error: inotify read");
+            status = 1;
+            break;
+        }
+        if (len == 0) {
+            fprintf(stderr, "Error: inotify read returned no events\n");
+            status = 1;
+            break;
+        }
+
+        bool changed = false;
+        for (char *p = buf; p < buf + len; ) {
+            struct inotify_event *event = (struct inotify_event *)p;
+            if (event->len > 0 && strcmp(event->name, name) == 0) {
+                changed = true;
+            }
+            p += sizeof(struct inotify_event) + event->len;
+        }
+
+        if (changed) {
+            stop_run(child);
+            printf("\n%s changed, re-running...\n", filename);
+            child = start_run(filename, vcd_file, &run_mask);
+        }
+    }
+
+    stop_run(child);
+    sigprocmask(SIG_SETMASK, &run_mask, NULL);
+    close(fd);
+    free(dir_copy);
+    free(name_copy);
+    return status;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 3 || strcmp(argv[1], "run") != 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    bool watch_mode = false;
+    const char *vcd_file = NULL;
+    const char *filename = NULL;
+
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "--watch") == 0) {
+            watch_mode = true;
+        } else if (strcmp(argv[i], "--vcd") == 0 && i + 1 < argc) {
+            vcd_file = argv[++i];
+        } else if (filename == NULL) {
+            filename = argv[i];
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (filename == NULL) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    install_stop_handler();
+    if (watch_mode) {
+        return watch(filename, vcd_file);
+    }
+    return assemble_and_run(filename, vcd_file);
+}
@@ -1,8 +1,13 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
 #include <stdbool.h>
 #include <unistd.h>
+#include <pthread.h>
+#include <signal.h>
+#include "k2_MICRO.h"
 
-#define IM_SIZE 16
 unsigned char IM[IM_SIZE];
 unsigned char MUX_OUT;
 
@@ -22,6 +27,234 @@ struct ControlSignals {
 
 unsigned char RA, RB, R0;
 
+// Set from a signal handler to end the run loops early, so a looping
+// program can still be stopped with its trace flushed
+volatile sig_atomic_t stop_requested = 0;
+
+static void request_stop(int sig) {
+    (void)sig;
+    stop_requested = 1;
+}
+
+void install_stop_handler(void) {
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = request_stop;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+}
+
+// Waveform trace: value changes are written as VCD through two buffers,
+// the simulator fills one while a writer thread flushes the other to disk
+#define TRACE_BUF_SIZE (1 << 16)
+#define TRACE_BUF_RESERVE 256
+
+enum {
+    SIG_J, SIG_C, SIG_D1, SIG_D0, SIG_SREG, SIG_S, SIG_IMM2, SIG_IMM1, SIG_IMM0,
+    SIG_MUX_OUT, SIG_RA, SIG_RB, SIG_R0, SIG_PC, SIG_CARRY, NUM_SIGNALS
+};
+
+static const struct {
+    const char *name;
+    int width;
+} trace_signals[NUM_SIGNALS] = {
+    {"j", 1}, {"c", 1}, {"D1", 1}, {"D0", 1}, {"sreg", 1}, {"s", 1},
+    {"imm2", 1}, {"imm1", 1}, {"imm0", 1},
+    {"MUX_OUT", 4}, {"RA", 4}, {"RB", 4}, {"R0", 4}, {"pc", 4}, {"carry", 1}
+};
+
+struct Trace {
+    FILE *fp;
+    char *buf[2];
+    size_t len[2];
+    int active;         // buffer currently filled by the simulator
+    int write_idx;      // buffer handed to the writer thread
+    bool pending;
+    bool done;
+    bool write_error;   // set by the writer thread, read after it is joined
+    pthread_t writer;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    unsigned char last[NUM_SIGNALS];
+    unsigned long time;
+};
+
+static void *trace_writer(void *arg) {
+    Trace *t = arg;
+
+    pthread_mutex_lock(&t->lock);
+    for (;;) {
+        while (!t->pending && !t->done) {
+            pthread_cond_wait(&t->cond, &t->lock);
+        }
+        if (!t->pending) break;
+
+        int idx = t->write_idx;
+        pthread_mutex_unlock(&t->lock);
+        if (fwrite(t->buf[idx], 1, t->len[idx], t->fp) != t->len[idx]) {
+            t->write_error = true;
+        }
+        pthread_mutex_lock(&t->lock);
+
+        t->len[idx] = 0;
+        t->pending = false;
+        pthread_cond_broadcast(&t->cond);
+    }
+    pthread_mutex_unlock(&t->lock);
+    return NULL;
+}
+
+// Hand the active buffer to the writer thread and continue in the other one
+static void trace_swap(Trace *t) {
+    pthread_mutex_lock(&t->lock);
+    while (t->pending) {
+        pthread_cond_wait(&t->cond, &t->lock);
+    }
+    t->write_idx = t->active;
+    t->pending = true;
+    t->active = !t->active;
+    pthread_cond_broadcast(&t->cond);
+    pthread_mutex_unlock(&t->lock);
+}
+
+static void trace_printf(Trace *t, const char *fmt, ...) {
+    if (t->len[t->active] > TRACE_BUF_SIZE - TRACE_BUF_RESERVE) {
+        trace_swap(t);
+    }
+
+    char *dst = t->buf[t->active] + t->len[t->active];
+    size_t room = TRACE_BUF_SIZE - t->len[t->active];
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(dst, room, fmt, ap);
+    va_end(ap);
+
+    if (n > 0) {
+        t->len[t->active] += ((size_t)n < room) ? (size_t)n : room - 1;
+    }
+}
+
+static void trace_value(Trace *t, int sig, unsigned char value) {
+    char id = '!' + sig;
+
+    if (trace_signals[sig].width == 1) {
+        trace_printf(t, "%d%c\n", value & 1, id);
+    } else {
+        char bits[9];
+        int w = trace_signals[sig].width;
+        for (int i = 0; i < w; i++) {
+            bits[i] = (value >> (w - 1 - i)) & 1 ? '1' : '0';
+        }
+        bits[w] = '\0';
+        trace_printf(t, "b%s %c\n", bits, id);
+    }
+}
+
+Trace *trace_open(const char *filename) {
+    Trace *t = calloc(1, sizeof(Trace));
+    if (t == NULL) return NULL;
+
+    t->fp = fopen(filename, "w");
+    t->buf[0] = malloc(TRACE_BUF_SIZE);
+    t->buf[1] = malloc(TRACE_BUF_SIZE);
+    if (t->fp == NULL || t->buf[0] == NULL || t->buf[1] == NULL) {
+        fprintf(stderr, "Error: Cannot open trace file %s\n", filename);
+        if (t->fp) fclose(t->fp);
+        free(t->buf[0]);
+        free(t->buf[1]);
+        free(t);
+        return NULL;
+    }
+
+    pthread_mutex_init(&t->lock, NULL);
+    pthread_cond_init(&t->cond, NULL);
+    if (pthread_create(&t->writer, NULL, trace_writer, t) != 0) {
+        fprintf(stderr, "Error: Cannot start trace writer for %s\n", filename);
+        pthread_mutex_destroy(&t->lock);
+        pthread_cond_destroy(&t->cond);
+        fclose(t->fp);
+        free(t->buf[0]);
+        free(t->buf[1]);
+        free(t);
+        return NULL;
+    }
+
+    trace_printf(t, "$version K2 simulator $end\n");
+    trace_printf(t, "$timescale 1ns $end\n");
+    trace_printf(t, "$scope module k2 $end\n");
+    for (int i = 0; i < NUM_SIGNALS; i++) {
+        trace_printf(t, "$var wire %d %c %s $end\n",
+                     trace_signals[i].width, '!' + i, trace_signals[i].name);
+    }
+    trace_printf(t, "$upscope $end\n");
+    trace_printf(t, "$enddefinitions $end\n");
+
+    // The simulator starts with every register and control line cleared
+    trace_printf(t, "#0\n$dumpvars\n");
+    for (int i = 0; i < NUM_SIGNALS; i++) {
+        trace_value(t, i, 0);
+    }
+    trace_printf(t, "$end\n");
+    return t;
+}
+
+// Record the machine state after one instruction, emitting only the
+// signals that changed since the previous call
+void trace_step(Trace *t, struct ControlSignals *ctrl, Registers *regs,
+                unsigned char pc, bool carry) {
+    if (t == NULL) return;
+
+    unsigned char now[NUM_SIGNALS] = {
+        [SIG_J] = ctrl->j, [SIG_C] = ctrl->c, [SIG_D1] = ctrl->D1,
+        [SIG_D0] = ctrl->D0, [SIG_SREG] = ctrl->sreg, [SIG_S] = ctrl->s,
+        [SIG_IMM2] = ctrl->imm2, [SIG_IMM1] = ctrl->imm1, [SIG_IMM0] = ctrl->imm0,
+        [SIG_MUX_OUT] = MUX_OUT, [SIG_RA] = regs->RA, [SIG_RB] = regs->RB,
+        [SIG_R0] = regs->R0, [SIG_PC] = pc, [SIG_CARRY] = carry
+    };
+
+    t->time++;
+    bool stamped = false;
+    for (int i = 0; i < NUM_SIGNALS; i++) {
+        if (now[i] == t->last[i]) continue;
+        if (!stamped) {
+            trace_printf(t, "#%lu\n", t->time);
+            stamped = true;
+        }
+        trace_value(t, i, now[i]);
+        t->last[i] = now[i];
+    }
+}
+
+// Flush and close the trace, returns -1 if any part of it failed to write
+int trace_close(Trace *t) {
+    if (t == NULL) return 0;
+
+    trace_printf(t, "#%lu\n", t->time + 1);
+
+    pthread_mutex_lock(&t->lock);
+    while (t->pending) {
+        pthread_cond_wait(&t->cond, &t->lock);
+    }
+    t->write_idx = t->active;
+    t->pending = true;
+    t->done = true;
+    pthread_cond_broadcast(&t->cond);
+    pthread_mutex_unlock(&t->lock);
+    pthread_join(t->writer, NULL);
+
+    pthread_mutex_destroy(&t->lock);
+    pthread_cond_destroy(&t->cond);
+    int status = t->write_error ? -1 : 0;
+    if (fclose(t->fp) != 0) {
+        status = -1;
+    }
+    free(t->buf[0]);
+    free(t->buf[1]);
+    free(t);
+    return status;
+}
+
 void load(unsigned char IM[], const char *filename) {
     FILE *fp = fopen(filename, "r");
     if (fp == NULL) {
@@ -29,12 +262,16 @@ void load(unsigned char IM[], const char *filename) {
         return;
     }
     
-    char line[9];
+    // Room for eight bits plus "\r\n" and the terminator
+    char line[16];
     int i = 0;
     
     while (fgets(line, sizeof(line), fp) && i < IM_SIZE) {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] == '\0') continue;
+
         unsigned char instruction = 0;
-        for (int j = 0; j < 8; j++) {
+        for (int j = 0; j < 8 && line[j] != '\0'; j++) {
             if (line[j] == '1') {
                 instruction |= (1 << (7-j));
             }
@@ -97,12 +334,11 @@ bool DFF(bool carry) {
     return stored_carry;
 }
 
-void execute(Registers *regs, struct ControlSignals *ctrl, unsigned char *pc) {
+void execute(Registers *regs, struct ControlSignals *ctrl, unsigned char *pc, bool *carry) {
     unsigned char sum;
-    bool carry;
 
-    sum = ALU(regs->RA, regs->RB, ctrl, &carry);
-    bool stored_carry = DFF(carry);
+    sum = ALU(regs->RA, regs->RB, ctrl, carry);
+    bool stored_carry = DFF(*carry);
     unsigned char imm = (ctrl->imm2 << 2) | (ctrl->imm1 << 1) | ctrl->imm0;
     
     decoder(ctrl->D1, ctrl->D0, sum, imm, ctrl->sreg);
@@ -141,33 +377,26 @@ void print_step_instruction(int inst_count, struct ControlSignals *ctrl, Registe
     }
 }
 
-void simulate(const char* filename) {
-    char mode;
+// Execute the program in IM from a cleared machine state
+void run_program(unsigned char IM[], char mode, Trace *trace) {
     Registers regs = {0};
     struct ControlSignals ctrl = {0};
     unsigned char pc = 0;
     bool carry = false;
 
-    printf("# Simulator Prompt\n");
-    printf("Select one of the following mode\n");
-    printf("R - Run in continuous mode\n");
-    printf("S - Run step-by-step\n");
-    printf("Select mode: ");
-    scanf(" %c", &mode);
-
-    printf("Loading binary file: %s\n", filename);
-    load(IM, filename);
+    RA = RB = R0 = MUX_OUT = 0;
 
     if (mode == 'S' || mode == 's') {
         printf("Starting Simulator in step-by-step mode...\n");
         int inst_count = 0;
 
-        while (pc < IM_SIZE) {
+        while (pc < IM_SIZE && !stop_requested) {
             unsigned char instruction = fetch_inst(IM, &pc);
             if (instruction == 0 && pc > 1) break;
             
             instructionDecode(instruction, &ctrl);
-            execute(&regs, &ctrl, &pc);
+            execute(&regs, &ctrl, &pc, &carry);
+            trace_step(trace, &ctrl, &regs, pc, carry);
             
             print_step_instruction(inst_count, &ctrl, &regs, carry);
             printf("[Press Enter to continue]\n");
@@ -183,12 +412,13 @@ void simulate(const char* filename) {
         printf("Starting Simulator in continuous mode...\n");
         printf("Execution (Register RO output):\n");
         
-        while (pc < IM_SIZE) {
+        while (pc < IM_SIZE && !stop_requested) {
             unsigned char instruction = fetch_inst(IM, &pc);
             if (instruction == 0 && pc > 1) break;
             
             instructionDecode(instruction, &ctrl);
-            execute(&regs, &ctrl, &pc);
+            execute(&regs, &ctrl, &pc, &carry);
+            trace_step(trace, &ctrl, &regs, pc, carry);
             
             if (ctrl.D1 == 1 && ctrl.D0 == 0) {
                 printf("RO=%d\n", regs.R0);
@@ -198,12 +428,60 @@ void simulate(const char* filename) {
     }
 }
 
+void simulate(const char* filename, Trace *trace) {
+    char mode;
+
+    printf("# Simulator Prompt\n");
+    printf("Select one of the following mode\n");
+    printf("R - Run in continuous mode\n");
+    printf("S - Run step-by-step\n");
+    printf("Select mode: ");
+    // Ctrl+C at the prompt interrupts scanf, stop rather than guess a mode
+    if (scanf(" %c", &mode) != 1 || stop_requested) {
+        printf("\n");
+        return;
+    }
+
+    printf("Loading binary file: %s\n", filename);
+    load(IM, filename);
+
+    run_program(IM, mode, trace);
+}
+
+#ifndef K2_NO_MAIN
+
 int main(int argc, char *argv[]) {
-    if (argc != 2) {
-        fprintf(stderr, "Usage: %s <filename>\n", argv[0]);
+    const char *vcd_file = NULL;
+    const char *filename = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--vcd") == 0 && i + 1 < argc) {
+            vcd_file = argv[++i];
+        } else if (filename == NULL) {
+            filename = argv[i];
+        } else {
+            filename = NULL;
+            break;
+        }
+    }
+
+    if (filename == NULL) {
+        fprintf(stderr, "Usage: %s [--vcd <trace.vcd>] <filename>\n", argv[0]);
         return 1;
     }
 
-    simulate(argv[1]);
+    Trace *trace = NULL;
+    if (vcd_file != NULL) {
+        trace = trace_open(vcd_file);
+        if (trace == NULL) return 1;
+    }
+
+    install_stop_handler();
+    simulate(filename, trace);
+    if (trace_close(trace) != 0) {
+        fprintf(stderr, "Error: Failed to write trace file %s\n", vcd_file);
+        return 1;
+    }
     return 0;
 }
+#endif
@@ -0,0 +1,23 @@
+#ifndef K2_MICRO_H
+#define K2_MICRO_H
+
+#include <signal.h>
+
+#define IM_SIZE 16
+
+extern unsigned char IM[IM_SIZE];
+
+typedef struct Trace Trace;
+
+// VCD waveform of the control signals and registers, NULL disables tracing
+Trace *trace_open(const char *filename);
+int trace_close(Trace *t);
+
+// SIGINT and SIGTERM set stop_requested, which makes run_program() return
+extern volatile sig_atomic_t stop_requested;
+void install_stop_handler(void);
+
+// Run the program already in IM; mode is 'R' (continuous) or 'S' (step)
+void run_program(unsigned char IM[], char mode, Trace *trace);
+
+#endif
@@ -0,0 +1,264 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "assimblyEdt.h"
+
+// Parallel streaming assembler. The source is memory-mapped and cut into
+// chunks at line boundaries. A ring of chunks is kept in flight, each on
+// its own thread; as soon as the oldest one is written to the .bin file
+// the next chunk starts encoding, so writing overlaps with encoding.
+// Output is byte-for-byte what k2asm writes for the same source, except
+// for lines of MAX_LINE_LENGTH bytes or more: k2asm's fgets() splits those
+// into pieces, here the whole line is reported as invalid.
+
+#define CHUNK_SIZE (4 << 20)
+#define CODE_WIDTH 9  // eight bits plus newline
+
+typedef struct {
+    int line;          // line number relative to the start of the chunk
+    const char *text;  // points into the mapped source
+    int len;
+} Diagnostic;
+
+typedef struct {
+    const char *start;
+    size_t len;
+
+    char *out;
+    size_t out_len;
+    long count;
+    int lines;
+
+    Diagnostic *diags;
+    int num_diags;
+    int diag_cap;
+} Chunk;
+
+static void add_diagnostic(Chunk *chunk, int line, const char *text, size_t len) {
+    while (len > 0 && isspace((unsigned char)*text)) {
+        text++;
+        len--;
+    }
+    while (len > 0 && isspace((unsigned char)text[len - 1])) {
+        len--;
+    }
+    if (len > MAX_LINE_LENGTH) {
+        len = MAX_LINE_LENGTH;
+    }
+
+    if (chunk->num_diags == chunk->diag_cap) {
+        chunk->diag_cap = chunk->diag_cap ? chunk->diag_cap * 2 : 16;
+        chunk->diags = realloc(chunk->diags, chunk->diag_cap * sizeof(Diagnostic));
+        if (chunk->diags == NULL) {
+            fprintf(stderr, "Error: Out of memory\n");
+            exit(1);
+        }
+    }
+    chunk->diags[chunk->num_diags++] = (Diagnostic){line, text, (int)len};
+}
+
+// Encode every line of one chunk into its own output buffer
+static void *assemble_chunk(void *arg) {
+    Chunk *chunk = arg;
+    const char *p = chunk->start;
+    const char *end = chunk->start + chunk->len;
+
+    size_t max_lines = 1;
+    for (const char *q = p; (q = memchr(q, '\n', end - q)) != NULL; q++) {
+        max_lines++;
+    }
+    chunk->out = malloc(max_lines * CODE_WIDTH);
+    if (chunk->out == NULL) {
+        fprintf(stderr, "Error: Out of memory\n");
+        exit(1);
+    }
+
+    char line[MAX_LINE_LENGTH];
+    char machine_code[9];
+
+    while (p < end) {
+        const char *eol = memchr(p, '\n', end - p);
+        if (eol == NULL) eol = end;
+        size_t len = eol - p;
+        chunk->lines++;
+
+        if (len < sizeof(line)) {
+            memcpy(line, p, len);
+            line[len] = '\0';
+            trim(line);
+
+            if (line[0] != '\0') {
+                if (convert_to_machine_code(line, machine_code) == -1) {
+                    add_diagnostic(chunk, chunk->lines, p, len);
+                } else {
+                    memcpy(chunk->out + chunk->out_len, machine_code, 8);
+                    chunk->out[chunk->out_len + 8] = '\n';
+                    chunk->out_len += CODE_WIDTH;
+                    chunk->count++;
+                }
+            }
+        } else {
+            add_diagnostic(chunk, chunk->lines, p, len);
+        }
+
+        p = eol + 1;
+    }
+    return NULL;
+}
+
+// Cut the next chunk at offset, ending just after a newline, and start it
+static void start_chunk(Chunk *chunk, pthread_t *thread, const char *src,
+                        size_t size, size_t *offset) {
+    size_t len = size - *offset;
+    if (len > CHUNK_SIZE) {
+        const char *nl = memchr(src + *offset + CHUNK_SIZE, '\n', len - CHUNK_SIZE);
+        len = nl ? (size_t)(nl - (src + *offset)) + 1 : len;
+    }
+
+    memset(chunk, 0, sizeof(Chunk));
+    chunk->start = src + *offset;
+    chunk->len = len;
+    *offset += len;
+
+    if (pthread_create(thread, NULL, assemble_chunk, chunk) != 0) {
+        fprintf(stderr, "Error: Failed to start assembler thread\n");
+        exit(1);
+    }
+}
+
+static void write_all(int fd, const char *buf, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, buf, len);
+        if (n < 0) {
+            perror("Error: Failed to write output file");
+            exit(1);
+        }
+        buf += n;
+        len -= n;
+    }
+}
+
+int main(int argc, char *argv[]) {
+    long num_threads = sysconf(_SC_NPROCESSORS_ONLN);
+    const char *filename = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            num_threads = atol(argv[++i]);
+        } else if (filename == NULL) {
+            filename = argv[i];
+        } else {
+            filename = NULL;
+            break;
+        }
+    }
+
+    if (filename == NULL || num_threads < 1) {
+        fprintf(stderr, "Usage: %s [-j threads] <file.asm>\n", argv[0]);
+        return 1;
+    }
+
+    int in_fd = open(filename, O_RDONLY);
+    struct stat st;
+    if (in_fd < 0 || fstat(in_fd, &st) < 0) {
+        fprintf(stderr, "Error: Failed to open input file %s\n", filename);
+        return 1;
+    }
+
+    const char *src = NULL;
+    size_t size = st.st_size;
+    if (size > 0) {
+        src = mmap(NULL, size, PROT_READ, MAP_PRIVATE, in_fd, 0);
+        if (src == MAP_FAILED) {
+            perror("Error: Failed to map input file");
+            return 1;
+        }
+        madvise((void *)src, size, MADV_SEQUENTIAL);
+    }
+
+    // Generate output filename the same way k2asm does
+    char output_filename[4096];
+    char *base_name = strdup(filename);
+    char *dot_pos = strrchr(base_name, '.');
+    if (dot_pos != NULL) {
+        *dot_pos = '\0';
+    }
+    snprintf(output_filename, sizeof(output_filename), "%s.bin", base_name);
+    free(base_name);
+
+    int out_fd = open(output_filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (out_fd < 0) {
+        fprintf(stderr, "Error: Failed to create output file %s\n", output_filename);
+        return 1;
+    }
+
+    // One slot more than there are encoders, so a full set keeps running
+    // while the oldest finished chunk is being written
+    long slots = num_threads + 1;
+    Chunk *chunks = calloc(slots, sizeof(Chunk));
+    pthread_t *threads = malloc(slots * sizeof(pthread_t));
+    if (chunks == NULL || threads == NULL) {
+        fprintf(stderr, "Error: Out of memory\n");
+        return 1;
+    }
+
+    size_t offset = 0;
+    long head = 0;
+    long in_flight = 0;
+    long line_base = 0;
+    long total = 0;
+    long warnings = 0;
+
+    while (in_flight < num_threads && offset < size) {
+        start_chunk(&chunks[in_flight], &threads[in_flight], src, size, &offset);
+        in_flight++;
+    }
+
+    // Flush in source order so output and line numbers stay sequential
+    while (in_flight > 0) {
+        Chunk *chunk = &chunks[head];
+        pthread_join(threads[head], NULL);
+
+        if (offset < size) {
+            long next = (head + in_flight) % slots;
+            start_chunk(&chunks[next], &threads[next], src, size, &offset);
+            in_flight++;
+        }
+
+        for (int d = 0; d < chunk->num_diags; d++) {
+            Diagnostic *diag = &chunk->diags[d];
+            fprintf(stderr, "Warning: Invalid instruction '%.*s' on line %ld\n",
+                    diag->len, diag->text, line_base + diag->line);
+        }
+        write_all(out_fd, chunk->out, chunk->out_len);
+
+        line_base += chunk->lines;
+        total += chunk->count;
+        warnings += chunk->num_diags;
+        free(chunk->out);
+        free(chunk->diags);
+
+        head = (head + 1) % slots;
+        in_flight--;
+    }
+
+    if (src != NULL) {
+        munmap((void *)src, size);
+    }
+    close(in_fd);
+    if (close(out_fd) < 0) {
+        perror("Error: Failed to write output file");
+        return 1;
+    }
+    free(chunks);
+    free(threads);
+
+    printf("Assembled %ld instructions (%ld warnings) into %s\n", total, warnings, output_filename);
+    return 0;
+}
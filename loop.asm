@@ -0,0 +1,4 @@
+RA=RA+RB
+RO=RA
+RB=9
+J=0